@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <unordered_set>
 #include <vector>
@@ -14,6 +15,8 @@ using namespace std;
 // Set the maximum size of the ngram
 static constexpr size_t max_pattern_len = 3;
 static constexpr size_t max_dictionary_size = 128;
+// Set the size of the chunks used to broadcast the database
+static constexpr size_t db_chunk_size = 1 << 20;  // 1MB
 static_assert(max_pattern_len > 1, "The pattern must contain at least one character");
 static_assert(max_dictionary_size > 1, "The dictionary must contain at least one element");
 
@@ -61,16 +64,21 @@ struct dictionary {
   }
 };
 
-size_t count_coverage(const string &dataset, const char *ngram) {
-  size_t index = 0;
+// Count the occurrences of the ngram in the portion of the dataset received so far, starting from index.
+// An occurrence that could still end in the next chunk is left to the next call, so calling this
+// function on growing prefixes of the dataset gives the same coverage as a single pass on the whole dataset
+size_t count_coverage(const string_view dataset, const char *ngram, const size_t ngram_size, size_t &index) {
   size_t counter = 0;
-  const size_t ngram_size = ::strlen(ngram);
   while (index < dataset.size()) {
-    index = dataset.find(ngram, index);
-    if (index != string::npos) {
-      ++counter;
-      index += ngram_size;
+    const size_t found = dataset.find(ngram, index, ngram_size);
+    if (found == string_view::npos) {
+      if (dataset.size() >= ngram_size) {
+        index = max(index, dataset.size() - ngram_size + 1);
+      }
+      break;
     }
+    ++counter;
+    index = found + ngram_size;
   }
   return counter * ngram_size;
 }
@@ -148,14 +156,24 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
   const int rc_alphabet = MPI_Bcast(alphabet.data(), alphabet.size(), MPI_CHAR, 0, MPI_COMM_WORLD);
   exit_on_fail(rc_alphabet);
 
-  // Send in broadcast the database and its size
+  // Send in broadcast the size of the database
   const int rc_db_size = MPI_Bcast(&db_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
   exit_on_fail(rc_db_size);
 
+  // Send in broadcast the database in chunks, so that the processes can start counting on the first chunks
+  // while the following ones are still being transferred
   database.resize(db_size);
-  const int rc_database = MPI_Bcast(database.data(), database.size(), MPI_CHAR, 0, MPI_COMM_WORLD);
-  exit_on_fail(rc_database);
-  
+  const size_t db_chunks = (database.size() + db_chunk_size - 1) / db_chunk_size;
+  vector<MPI_Request> db_requests(db_chunks, MPI_REQUEST_NULL);
+  for (size_t chunk{0}; chunk < db_chunks; ++chunk) {
+    const size_t chunk_begin = chunk * db_chunk_size;
+    const size_t chunk_size = min(db_chunk_size, database.size() - chunk_begin);
+    const int rc_database = MPI_Ibcast(database.data() + chunk_begin, chunk_size, MPI_CHAR, 0, MPI_COMM_WORLD,
+                                       &db_requests[chunk]);
+    exit_on_fail(rc_database);
+  }
+  size_t db_received = 0;
+
   // Precompute the number of permutations according to the number of characters
   auto permutations = vector(max_pattern_len, alphabet.size());
   for (size_t i{1}; i < permutations.size(); ++i) {
@@ -173,6 +191,22 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
     start_index[i] = rank * ngrams_per_process[i];
     end_index[i] = min((rank + 1) * ngrams_per_process[i], total_ngrams[i]) - 1;
   }
+
+  // Compose the ngrams of every size while the database is still in flight
+  vector<word> words[max_pattern_len];
+  for (size_t ngram_size{1}; ngram_size <= max_pattern_len; ++ngram_size) {
+    // Distribute work among MPI processes
+    for (size_t word_index = start_index[ngram_size-1]; word_index <= end_index[ngram_size-1]; ++word_index) {
+      word current_word;
+      memset(current_word.ngram, '\0', max_pattern_len + 1);
+      for (size_t character_index{0}, remaining_size = word_index; character_index < ngram_size;
+              ++character_index, remaining_size /= alphabet.size()) {
+          current_word.ngram[character_index] = alphabet[remaining_size % alphabet.size()];
+      }
+      current_word.size = ngram_size;
+      words[ngram_size-1].push_back(current_word);
+    }
+  }
  
   // Declare the dictionary that holds all the ngrams with the greatest coverage of the dictionary
   dictionary result;
@@ -180,27 +214,50 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
   MPI_Datatype mpiWordType;
   createMPIWordType(&mpiWordType);
 
+  // The gather of the ngrams of size k (and the merge on P0) overlaps with the computation of size k+1
+  vector<word> all_words[max_pattern_len];
+  MPI_Request gather_requests[max_pattern_len];
+  fill(begin(gather_requests), end(gather_requests), MPI_REQUEST_NULL);
+
+  // Wait for the gather of the ngrams of the given size and let P0 populate the dictionary with them
+  auto merge_words = [&](const size_t ngram_size) {
+    const int rc_wait_words = MPI_Wait(&gather_requests[ngram_size-1], MPI_STATUS_IGNORE);
+    exit_on_fail(rc_wait_words);
+    if(rank==0){
+      for(auto w : all_words[ngram_size-1]){
+        result.add_word(w);
+      }
+    }
+    all_words[ngram_size-1] = vector<word>{};
+  };
+
   // Compute the ngrams and their coverage
   for (size_t ngram_size{1}; ngram_size <= max_pattern_len; ++ngram_size) {
     if(rank==0){
       cerr << "Computing ngrams of size " << ngram_size << " and their coverage ..." << endl;
     }
-    vector<word> all_words;
-    vector<word> words;           
-
-    // Distribute work among MPI processes
-    for (size_t word_index = start_index[ngram_size-1]; word_index <= end_index[ngram_size-1]; ++word_index) {
-      // Compose the ngram
-      word current_word;
-      memset(current_word.ngram, '\0', max_pattern_len + 1);
-      for (size_t character_index{0}, remaining_size = word_index; character_index < ngram_size;
-              ++character_index, remaining_size /= alphabet.size()) {
-          current_word.ngram[character_index] = alphabet[remaining_size % alphabet.size()];
+    auto &current_words = words[ngram_size-1];
+    vector<size_t> search_index(current_words.size(), 0);
+
+    // Count the coverage one chunk of the database at a time, waiting for a chunk only when it is needed
+    for (size_t chunk{0}; chunk < db_chunks; ++chunk) {
+      if (chunk == db_received) {
+        const int rc_wait_database = MPI_Wait(&db_requests[chunk], MPI_STATUS_IGNORE);
+        exit_on_fail(rc_wait_database);
+        ++db_received;
+      }
+      // Give the MPI library the chance to progress the gather of the previous size
+      if (ngram_size > 1) {
+        int gather_done = 0;
+        const int rc_test_words = MPI_Test(&gather_requests[ngram_size-2], &gather_done, MPI_STATUS_IGNORE);
+        exit_on_fail(rc_test_words);
       }
 
-      current_word.size = ngram_size;
-      current_word.coverage = count_coverage(database, current_word.ngram);
-      words.push_back(current_word);
+      const auto available = string_view{database.data(), min((chunk + 1) * db_chunk_size, database.size())};
+      for (size_t i{0}; i < current_words.size(); ++i) {
+        current_words[i].coverage +=
+            count_coverage(available, current_words[i].ngram, ngram_size, search_index[i]);
+      }
     }
 
     /*
@@ -209,26 +266,27 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[]) {
     * the number of processors used
     */
     // Sort and remove whats beyond max_dictionary_size, keep only the ngrams with highest coverage
-    /*std::sort(words.begin(), words.end(), compareByCoverage);
-    if (words.size() > max_dictionary_size) {
-      words.erase(words.begin() + max_dictionary_size, words.end());
+    /*std::sort(current_words.begin(), current_words.end(), compareByCoverage);
+    if (current_words.size() > max_dictionary_size) {
+      current_words.erase(current_words.begin() + max_dictionary_size, current_words.end());
     }*/
 
     if(rank==0){
-      all_words.resize(words.size() * size);
+      all_words[ngram_size-1].resize(current_words.size() * size);
     }
 
-    // Gather to P0 all the computed ngrams and respective coverages
-    const int rc_gather_words = MPI_Gather(words.data(), words.size(), mpiWordType, all_words.data(), words.size(), mpiWordType, 0, MPI_COMM_WORLD);
+    // Gather to P0 all the computed ngrams and respective coverages, without waiting for completion
+    const int rc_gather_words = MPI_Igather(current_words.data(), current_words.size(), mpiWordType,
+                                            all_words[ngram_size-1].data(), current_words.size(), mpiWordType,
+                                            0, MPI_COMM_WORLD, &gather_requests[ngram_size-1]);
     exit_on_fail(rc_gather_words);
 
-    // Only P0 populates the dictionary
-    if(rank==0){
-      for(auto w : all_words){
-        result.add_word(w);
-      }
+    // While the ngrams of this size are in flight, P0 merges the ones of the previous size
+    if (ngram_size > 1) {
+      merge_words(ngram_size - 1);
     }
   }
+  merge_words(max_pattern_len);
 
   // Generate the final dictionary
   // NOTE: we sort it for pretty-printing